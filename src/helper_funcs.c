@@ -10,7 +10,9 @@
 
 // Called with wrong arguments.
 void usage(char* argv0) {
-	printf("usage : %s portnumber\n", argv0);
+	printf("usage : %s portnumber [-l [cpulist]] [-t]\n", argv0);
+	printf("\t-l\tlow-latency profile, pin connection threads to cpulist (i.e 2,3 or 4-7)\n");
+	printf("\t-t\tkeep ring of recent request traces, dumped on SIGUSR1 or GET /.trace\n");
 	exit(EXIT_SUCCESS);
 }
 
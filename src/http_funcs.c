@@ -1,5 +1,7 @@
 #include <string.h>
 #include <stdio.h>
+#include <strings.h>
+#include <errno.h>
 #include <arpa/inet.h>
 
 #include "http_funcs.h"
@@ -21,6 +23,7 @@ int check_http_request(char* lineBUF, char** path_token_ptr, const size_t pathle
     if (strcmp(request_type, "GET") == 0) flags |= HTTP_GET;
     else if (strcmp(request_type, "POST") == 0) flags |= HTTP_POST;
     else if (strcmp(request_type, "HEAD") == 0) flags |= HTTP_HEAD;
+    else if (strcmp(request_type, "PUT") == 0) flags |= HTTP_PUT;
     else flags |= INVALID_REQUEST; // no valid http1.0 request
 
     // skip spaces and forward to / (delim space to include / in str)
@@ -41,6 +44,84 @@ int check_http_request(char* lineBUF, char** path_token_ptr, const size_t pathle
     else return flags | UNSUPPORTED_VERSION;
 }
 
+/*  Parses the header lines following the request line (continuing strtok_r on saveptr) for the body framing.
+    Sets content_length to the value of Content-Length or -1 if not present.
+    Sets expect_continue to 1 if the client waits for "100 Continue" before sending the body.
+    returns -1 on malformed or conflicting headers, 1 if Transfer-Encoding is chunked else 0   */
+int check_http_body_headers(char** saveptr, const char* delimeter, long long* content_length, int* expect_continue){
+
+    const char* cl_name = "Content-Length:";
+    const char* te_name = "Transfer-Encoding:";
+    const char* expect_name = "Expect:";
+    char* lineBUF, *value, *end;
+    long long length;
+    int chunked = 0;
+
+    *content_length = -1;
+    *expect_continue = 0;
+
+    // header names are case-insensitive, values may be surrounded by whitespace
+    while ((lineBUF = strtok_r(NULL, delimeter, saveptr)) != NULL) {
+        if (strncasecmp(lineBUF, cl_name, strlen(cl_name)) == 0) {
+            value = lineBUF + strlen(cl_name);
+            errno = 0;
+            length = strtoll(value, &end, 10);
+            if (end == value || errno != 0 || length < 0) return -1;
+            end += strspn(end, " \t");
+            if (*end != '\0') return -1;
+            // repeated header is only allowed with the same value
+            if (*content_length >= 0 && *content_length != length) return -1;
+            *content_length = length;
+        }
+        else if (strncasecmp(lineBUF, te_name, strlen(te_name)) == 0) {
+            value = lineBUF + strlen(te_name);
+            value += strspn(value, " \t");
+            // no other codings supported
+            if (strncasecmp(value, "chunked", strlen("chunked")) != 0) return -1;
+            value += strlen("chunked");
+            if (value[strspn(value, " \t")] != '\0') return -1;
+            chunked = 1;
+        }
+        else if (strncasecmp(lineBUF, expect_name, strlen(expect_name)) == 0) {
+            value = lineBUF + strlen(expect_name);
+            value += strspn(value, " \t");
+            if (strncasecmp(value, "100-continue", strlen("100-continue")) == 0) {
+                value += strlen("100-continue");
+                if (value[strspn(value, " \t")] == '\0') *expect_continue = 1;
+            }
+        }
+    }
+
+    // both framings at once is ambiguous (request smuggling), see RFC 7230 3.3.3
+    if (chunked && *content_length >= 0) return -1;
+
+    return chunked;
+}
+
+// returns 1 if path contains a ".." segment else 0
+int check_path_traversal(const char* path){
+    const char* segment = path;
+    size_t len;
+
+    while (*segment != '\0') {
+        len = strcspn(segment, "/");
+        if (len == 2 && strncmp(segment, "..", 2) == 0) return 1;
+        segment += len;
+        if (*segment == '/') segment++;
+    }
+    return 0;
+}
+
+// using given socket, send interim 100 Continue (client waits for it before sending the body)
+void send_100(const int connfd){
+    if (connfd <= 0) return;
+
+    const char* answer = "HTTP/1.1 100 Continue\r\n\r\n";
+
+    if (send(connfd, answer, strlen(answer), 0) < 0)
+        sys_warn("send_100() : send()");
+}
+
 // using given socket, send 501 - not implemented
 void send_501(const int connfd, char* sendBUF, const size_t buflen){
     if (connfd <= 0) return;
@@ -116,6 +197,131 @@ void send_404(const int connfd, char* sendBUF, const size_t buflen) {
         sys_warn("send_404() : send()");
 }
 
+// using given socket, send 403 Forbidden
+void send_403(const int connfd, char* sendBUF, const size_t buflen) {
+    if (connfd <= 0) return;
+    if (sendBUF == NULL || buflen == 0) return;
+
+    memset(sendBUF, 0, buflen);
+
+    const char* answer_line =       "HTTP/1.0 403 Forbidden\r\n";
+    const char* content_type =      "Content-type: text/html\r\n";
+    const char* server =            "Server: MicroWWW Team 06\r\n";
+    const char* content_length =    "Content-length: 51\r\n";
+    const char* crlf =              "\r\n";
+    const char* entity_body =       "<html><body><b>403</b> - Forbidden </body></html>\r\n";
+
+    strcat(sendBUF, answer_line);
+    strcat(sendBUF, content_type);
+    strcat(sendBUF, server);
+    strcat(sendBUF, content_length);
+    strcat(sendBUF, crlf);
+    strcat(sendBUF, entity_body);
+
+    if (send(connfd, sendBUF, strlen(sendBUF), 0) < 0)
+        sys_warn("send_403() : send()");
+}
+
+// using given socket, send 411 Length Required
+void send_411(const int connfd, char* sendBUF, const size_t buflen) {
+    if (connfd <= 0) return;
+    if (sendBUF == NULL || buflen == 0) return;
+
+    memset(sendBUF, 0, buflen);
+
+    const char* answer_line =       "HTTP/1.0 411 Length Required\r\n";
+    const char* content_type =      "Content-type: text/html\r\n";
+    const char* server =            "Server: MicroWWW Team 06\r\n";
+    const char* content_length =    "Content-length: 57\r\n";
+    const char* crlf =              "\r\n";
+    const char* entity_body =       "<html><body><b>411</b> - Length Required </body></html>\r\n";
+
+    strcat(sendBUF, answer_line);
+    strcat(sendBUF, content_type);
+    strcat(sendBUF, server);
+    strcat(sendBUF, content_length);
+    strcat(sendBUF, crlf);
+    strcat(sendBUF, entity_body);
+
+    if (send(connfd, sendBUF, strlen(sendBUF), 0) < 0)
+        sys_warn("send_411() : send()");
+}
+
+// using given socket, send 413 Payload Too Large
+void send_413(const int connfd, char* sendBUF, const size_t buflen) {
+    if (connfd <= 0) return;
+    if (sendBUF == NULL || buflen == 0) return;
+
+    memset(sendBUF, 0, buflen);
+
+    const char* answer_line =       "HTTP/1.0 413 Payload Too Large\r\n";
+    const char* content_type =      "Content-type: text/html\r\n";
+    const char* server =            "Server: MicroWWW Team 06\r\n";
+    const char* content_length =    "Content-length: 59\r\n";
+    const char* crlf =              "\r\n";
+    const char* entity_body =       "<html><body><b>413</b> - Payload Too Large </body></html>\r\n";
+
+    strcat(sendBUF, answer_line);
+    strcat(sendBUF, content_type);
+    strcat(sendBUF, server);
+    strcat(sendBUF, content_length);
+    strcat(sendBUF, crlf);
+    strcat(sendBUF, entity_body);
+
+    if (send(connfd, sendBUF, strlen(sendBUF), 0) < 0)
+        sys_warn("send_413() : send()");
+}
+
+// using given socket, send 431 Request Header Fields Too Large
+void send_431(const int connfd, char* sendBUF, const size_t buflen) {
+    if (connfd <= 0) return;
+    if (sendBUF == NULL || buflen == 0) return;
+
+    memset(sendBUF, 0, buflen);
+
+    const char* answer_line =       "HTTP/1.0 431 Request Header Fields Too Large\r\n";
+    const char* content_type =      "Content-type: text/html\r\n";
+    const char* server =            "Server: MicroWWW Team 06\r\n";
+    const char* content_length =    "Content-length: 73\r\n";
+    const char* crlf =              "\r\n";
+    const char* entity_body =       "<html><body><b>431</b> - Request Header Fields Too Large </body></html>\r\n";
+
+    strcat(sendBUF, answer_line);
+    strcat(sendBUF, content_type);
+    strcat(sendBUF, server);
+    strcat(sendBUF, content_length);
+    strcat(sendBUF, crlf);
+    strcat(sendBUF, entity_body);
+
+    if (send(connfd, sendBUF, strlen(sendBUF), 0) < 0)
+        sys_warn("send_431() : send()");
+}
+
+// using given socket, send 500 Internal Server Error
+void send_500(const int connfd, char* sendBUF, const size_t buflen) {
+    if (connfd <= 0) return;
+    if (sendBUF == NULL || buflen == 0) return;
+
+    memset(sendBUF, 0, buflen);
+
+    const char* answer_line =       "HTTP/1.0 500 Internal Server Error\r\n";
+    const char* content_type =      "Content-type: text/html\r\n";
+    const char* server =            "Server: MicroWWW Team 06\r\n";
+    const char* content_length =    "Content-length: 63\r\n";
+    const char* crlf =              "\r\n";
+    const char* entity_body =       "<html><body><b>500</b> - Internal Server Error </body></html>\r\n";
+
+    strcat(sendBUF, answer_line);
+    strcat(sendBUF, content_type);
+    strcat(sendBUF, server);
+    strcat(sendBUF, content_length);
+    strcat(sendBUF, crlf);
+    strcat(sendBUF, entity_body);
+
+    if (send(connfd, sendBUF, strlen(sendBUF), 0) < 0)
+        sys_warn("send_500() : send()");
+}
+
 // using given socket, send 200 OK & file length
 void send_200(const int connfd, int fileLEN, char* sendBUF, const size_t buflen) {
     if (connfd <= 0) return;
@@ -144,6 +350,31 @@ void send_200(const int connfd, int fileLEN, char* sendBUF, const size_t buflen)
         sys_warn("send_200() : send()");
 }
 
+// using given socket, send 201 Created
+void send_201(const int connfd, char* sendBUF, const size_t buflen) {
+    if (connfd <= 0) return;
+    if (sendBUF == NULL || buflen == 0) return;
+
+    memset(sendBUF, 0, buflen);
+
+    const char* answer_line =       "HTTP/1.0 201 Created\r\n";
+    const char* content_type =      "Content-type: text/html\r\n";
+    const char* server =            "Server: MicroWWW Team 06\r\n";
+    const char* content_length =    "Content-length: 49\r\n";
+    const char* crlf =              "\r\n";
+    const char* entity_body =       "<html><body><b>201</b> - Created </body></html>\r\n";
+
+    strcat(sendBUF, answer_line);
+    strcat(sendBUF, content_type);
+    strcat(sendBUF, server);
+    strcat(sendBUF, content_length);
+    strcat(sendBUF, crlf);
+    strcat(sendBUF, entity_body);
+
+    if (send(connfd, sendBUF, strlen(sendBUF), 0) < 0)
+        sys_warn("send_201() : send()");
+}
+
 // print message based on flags
 // i.e "client 1: GET /requested/path"
 void print_client_msgtype(const int request_flags, const char* path, const int client_nr, const char* addr_str){
@@ -162,5 +393,8 @@ void print_client_msgtype(const int request_flags, const char* path, const int c
     else if (request_flags & HTTP_HEAD){
         printf("client %d (%s): HEAD %s\n", client_nr, addr_str, path);
     }
+    else if (request_flags & HTTP_PUT){
+        printf("client %d (%s): PUT %s\n", client_nr, addr_str, path);
+    }
 }
 
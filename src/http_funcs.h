@@ -10,7 +10,8 @@ enum request_flags {
     HTTP_POST = 8,
     HTTP_HEAD = 16,
     EMPTY_PATH = 32,
-} request_flag ;
+    HTTP_PUT = 64,
+};
 
 enum http_status_codes {
     OK = 200,
@@ -24,11 +25,14 @@ enum http_status_codes {
     UNAUTHORIZED = 401,
     FORBIDDEN = 403,
     NOT_FOUND = 404,
+    LENGTH_REQUIRED = 411,
+    PAYLOAD_TOO_LARGE = 413,
+    REQUEST_HEADER_FIELDS_TOO_LARGE = 431,
     INTERNAL_SERVER_ERROR = 500,
     NOT_IMPLEMENTED = 501,
     BAD_GATEWAY = 502,
     SERVICE_UNAVAILABLE = 503,
-} http_status_code ;
+};
 
 /*  Parses one line token by token setting flags.
     Sets path_token_ptr to null-terminated string containing the requested path (might become NULL).
@@ -37,14 +41,30 @@ enum http_status_codes {
     returns -1 on error else http_request flags set   */
 int check_http_request(char* lineBUF, char** path_token_ptr, const size_t pathlen_max, char** saveptr);
 
+/*  Parses the header lines following the request line (continuing strtok_r on saveptr) for the body framing.
+    Sets content_length to the value of Content-Length or -1 if not present.
+    Sets expect_continue to 1 if the client waits for "100 Continue" before sending the body.
+    returns -1 on malformed or conflicting headers, 1 if Transfer-Encoding is chunked else 0   */
+int check_http_body_headers(char** saveptr, const char* delimeter, long long* content_length, int* expect_continue);
+
+// returns 1 if path contains a ".." segment else 0
+int check_path_traversal(const char* path);
+
 // print message based on flags
 // i.e "client 1: GET /requested/path"
 void print_client_msgtype(const int request_flags, const char* path, const int client_nr, const char* addr_str);
 
 // responses with status codes
+void send_100(const int connfd);
 void send_200(const int connfd, int fileLEN, char* sendBUF, const size_t buflen);
+void send_201(const int connfd, char* sendBUF, const size_t buflen);
 void send_400(const int connfd, char* sendBUF, const size_t buflen);
+void send_403(const int connfd, char* sendBUF, const size_t buflen);
 void send_404(const int connfd, char* sendBUF, const size_t buflen);
+void send_411(const int connfd, char* sendBUF, const size_t buflen);
+void send_413(const int connfd, char* sendBUF, const size_t buflen);
+void send_431(const int connfd, char* sendBUF, const size_t buflen);
+void send_500(const int connfd, char* sendBUF, const size_t buflen);
 void send_501(const int connfd, char* sendBUF, const size_t buflen);
 
 #endif // HTTP_FUNCS_H
@@ -0,0 +1,149 @@
+#define _GNU_SOURCE // pthread_setaffinity_np, CPU_SET
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "lowlat.h"
+#include "helper_funcs.h"
+
+// not in older libc headers
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+// set one option and print the outcome, return 0 on success or -1 if failure
+static int report_sockopt(const int sockfd, const int level, const int optname, const char* name, const int val) {
+    if (setsockopt(sockfd, level, optname, &val, sizeof(val)) < 0) {
+        printf("  %-20s %-8d failed (%s)\n", name, val, strerror(errno));
+        return -1;
+    }
+    printf("  %-20s %-8d ok\n", name, val);
+    return 0;
+}
+
+// add cpu to profile if not already in it
+static int add_cpu(lowlat_profile_t* profile, const int cpu) {
+    for (size_t i=0; i<profile->nr_cpus; i++)
+        if (profile->cpus[i] == cpu) return 0;
+    if (profile->nr_cpus >= LOWLAT_MAX_CPUS || cpu >= CPU_SETSIZE) return -1;
+    profile->cpus[profile->nr_cpus++] = cpu;
+    return 0;
+}
+
+/*  Parses a comma separated list of cpu numbers or ranges (i.e "2,3" or "4-7") into profile.
+    returns -1 on error else number of cpus parsed   */
+int lowlat_parse_cpulist(lowlat_profile_t* profile, const char* cpulist) {
+
+    if (profile == NULL || cpulist == NULL) return -1;
+
+    const char* pos = cpulist;
+    char* end;
+    long first, last;
+
+    while (*pos != '\0') {
+        first = strtol(pos, &end, 10);
+        if (end == pos || first < 0) return -1;
+        last = first;
+        if (*end == '-') {
+            pos = end+1;
+            last = strtol(pos, &end, 10);
+            if (end == pos || last < first) return -1;
+        }
+        for (long cpu=first; cpu<=last; cpu++)
+            if (add_cpu(profile, (int)cpu) < 0) return -1;
+
+        if (*end == ',') end++;
+        else if (*end != '\0') return -1;
+        pos = end;
+    }
+
+    return (int)profile->nr_cpus;
+}
+
+// set listening socket options and report each of them (accepted sockets inherit them)
+void lowlat_apply_server(const lowlat_profile_t* profile, const int sockfd) {
+    if (profile == NULL || !profile->enabled) return;
+
+    printf("Low-latency profile:\n");
+    report_sockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", 1);
+    report_sockopt(sockfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, "TCP_DEFER_ACCEPT", LOWLAT_DEFER_ACCEPT_SEC);
+    report_sockopt(sockfd, IPPROTO_TCP, TCP_FASTOPEN, "TCP_FASTOPEN", LOWLAT_FASTOPEN_QLEN);
+    report_sockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, "SO_BUSY_POLL", LOWLAT_BUSY_POLL_USEC);
+    report_sockopt(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, "SO_PREFER_BUSY_POLL", 1);
+    report_sockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, "SO_BUSY_POLL_BUDGET", LOWLAT_BUSY_POLL_BUDGET);
+    report_sockopt(sockfd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", LOWLAT_SOCKBUF_SIZE);
+    report_sockopt(sockfd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", LOWLAT_SOCKBUF_SIZE);
+    // busy polling only happens inside blocking recv, nonblocking recv polls once at most
+    printf("  %-20s %-8d blocking recv, poll on accept\n", "wait (ms)", LOWLAT_WAIT_MSEC);
+
+    if (profile->nr_cpus == 0) {
+        printf("  %-20s %-8s no cpus configured\n", "cpu pinning", "off");
+        return;
+    }
+    printf("  %-20s %-8s cpus", "cpu pinning", "on");
+    for (size_t i=0; i<profile->nr_cpus; i++)
+        printf(" %d", profile->cpus[i]);
+    printf(" (SO_INCOMING_CPU preferred)\n");
+}
+
+// set per connection socket options incl. SO_RCVTIMEO for blocking recv (only warns on failure)
+void lowlat_apply_client(const lowlat_profile_t* profile, const int connfd) {
+    if (profile == NULL || !profile->enabled) return;
+
+    // inherited from the listening socket on linux, set again to not depend on that
+    int nodelay = 1;
+    if (setsockopt(connfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) < 0)
+        sys_warn("lowlat_apply_client : TCP_NODELAY");
+
+    // connection thread blocks in recv (busy polling for SO_BUSY_POLL usec) instead of
+    // sleeping between nonblocking calls, timeout lets it still check the exit flag
+    struct timeval timeout = {0, LOWLAT_WAIT_MSEC*1000};
+    if (setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+        sys_warn("lowlat_apply_client : SO_RCVTIMEO");
+}
+
+/*  Pins calling thread to the cpu that received the packets of connfd (SO_INCOMING_CPU)
+    if that cpu is in the profile, else to a configured cpu chosen by client_nr.
+    returns -1 if not pinned else the cpu number   */
+int lowlat_pin_thread(const lowlat_profile_t* profile, const int connfd, const int client_nr) {
+    if (profile == NULL || !profile->enabled || profile->nr_cpus == 0) return -1;
+
+    int cpu = -1, incoming_cpu = -1;
+    socklen_t optlen = sizeof(incoming_cpu);
+
+    // keep connection on the core its softirqs run on if we are allowed to run there
+    if (getsockopt(connfd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, &optlen) == 0)
+        for (size_t i=0; i<profile->nr_cpus; i++)
+            if (profile->cpus[i] == incoming_cpu) cpu = incoming_cpu;
+
+    // otherwise spread connections round robin over the configured cpus
+    if (cpu < 0)
+        cpu = profile->cpus[(size_t)client_nr % profile->nr_cpus];
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (err != 0) {
+        errno = err;
+        sys_warn("lowlat_pin_thread : pthread_setaffinity_np");
+        return -1;
+    }
+
+    return cpu;
+}
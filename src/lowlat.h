@@ -0,0 +1,38 @@
+#ifndef LOWLAT_H
+#define LOWLAT_H
+
+#include <stdlib.h>
+
+// low-latency startup profile: cpu pinning of connection threads and socket options cutting
+// scheduler/softirq jitter out of the request path (enabled with -l on the command line)
+
+#define LOWLAT_MAX_CPUS 64
+#define LOWLAT_DEFER_ACCEPT_SEC 1 // wake accept() only once data arrived (or after this timeout)
+#define LOWLAT_FASTOPEN_QLEN 16 // max pending TFO requests (see tcp(7))
+#define LOWLAT_BUSY_POLL_USEC 50 // time to busy poll on recv before sleeping (needs CAP_NET_ADMIN to raise)
+#define LOWLAT_BUSY_POLL_BUDGET 8 // max packets per busy poll (needs CAP_NET_ADMIN to raise)
+#define LOWLAT_SOCKBUF_SIZE (256*1024) // SO_RCVBUF/SO_SNDBUF (kernel doubles this value)
+#define LOWLAT_WAIT_MSEC 100 // max time blocked in recv (SO_RCVTIMEO) or poll before checking exit flag
+
+typedef struct {
+    int enabled;
+    int cpus[LOWLAT_MAX_CPUS]; // cpus connection threads may be pinned to
+    size_t nr_cpus; // 0 -> no pinning
+} lowlat_profile_t;
+
+/*  Parses a comma separated list of cpu numbers or ranges (i.e "2,3" or "4-7") into profile.
+    returns -1 on error else number of cpus parsed   */
+int lowlat_parse_cpulist(lowlat_profile_t* profile, const char* cpulist);
+
+// set listening socket options and report each of them (accepted sockets inherit them)
+void lowlat_apply_server(const lowlat_profile_t* profile, const int sockfd);
+
+// set per connection socket options incl. SO_RCVTIMEO for blocking recv (only warns on failure)
+void lowlat_apply_client(const lowlat_profile_t* profile, const int connfd);
+
+/*  Pins calling thread to the cpu that received the packets of connfd (SO_INCOMING_CPU)
+    if that cpu is in the profile, else to a configured cpu chosen by client_nr.
+    returns -1 if not pinned else the cpu number   */
+int lowlat_pin_thread(const lowlat_profile_t* profile, const int connfd, const int client_nr);
+
+#endif // LOWLAT_H
@@ -10,10 +10,14 @@
 #include <fcntl.h>
 #include <sys/sem.h>
 #include <errno.h>
+#include <poll.h>
 
 #include "helper_funcs.h"
 #include "http_funcs.h"
 #include "tidstack.h"
+#include "lowlat.h"
+#include "upload.h"
+#include "trace.h"
 
 #define FILE_ROOT "/var/microwww/"
 #define FILEPATH_BUF 256
@@ -30,6 +34,7 @@ typedef struct {
 	int clientnr;
 	struct sockaddr_in client_addr;
 	socklen_t addrlen;
+	uint64_t accept_ts; // for trace ring, 0 if disabled
 } thread_args_t;
 
 typedef struct {
@@ -46,6 +51,9 @@ static void thread_exithandler(void *);
 // lock/unlock semaphore
 int sem_operation();
 
+// send trace ring as 200 response
+static void send_trace_dump(const int connfd, char* sendBUF);
+
 // WARNING: not thread-safe -> only use in main thread (or protect with semaphore)
 // global vars needed for semaphore or needed inside threads and main
 int server_sockfd = -1, client_sockfd;
@@ -57,6 +65,10 @@ volatile int thread_counter = 0; // WARNING always use mutex on writes to be thr
 static pthread_mutex_t threadcount_mutex = PTHREAD_MUTEX_INITIALIZER;
 // semaphore because it gets locked and unlocked in different threads
 static int copysem_id; 
+// low-latency profile, only written in main before the first thread is created
+static lowlat_profile_t lowlat_profile = {0};
+// set on SIGUSR1, main loop dumps the trace ring
+volatile sig_atomic_t trace_dump_requested = 0;
 
 // let program finish normally if recieving SIGINT or SIGTERM
 void sighandler(int signo){
@@ -84,15 +96,38 @@ void sighandler(int signo){
 	// -> dont use blocking calls
 }
 
+// SIGUSR1: let main loop dump the trace ring (printing is not signal safe)
+void usr1handler(int signo){
+	(void)signo;
+	trace_dump_requested = 1;
+}
+
 int main(int argc, char **argv){
 
 	// Check for right number of arguments
-	if (argc != 2) usage(argv[0]);
+	// optional: -l [cpulist] for the low-latency profile, -t for the request trace ring
+	if (argc < 2) usage(argv[0]);
+	for (int i=2; i<argc; i++) {
+		if (strcmp(argv[i], "-l") == 0) {
+			lowlat_profile.enabled = 1;
+			if (i+1 < argc && argv[i+1][0] != '-' && lowlat_parse_cpulist(&lowlat_profile, argv[++i]) < 0) {
+				fprintf(stderr, "invalid cpulist: %s\n", argv[i]);
+				usage(argv[0]);
+			}
+		}
+		else if (strcmp(argv[i], "-t") == 0)
+			trace_ring_init(TRACE_RING_SIZE);
+		else
+			usage(argv[0]);
+	}
 
 	struct sockaddr_in server_addr, client_addr;
 	socklen_t addrlen = sizeof(struct sockaddr_in);
 	int client_id_counter = 1;
 	pthread_t tid;
+	sigset_t usr1_set, old_set; // SIGUSR1 only gets handled in main thread
+	sigemptyset(&usr1_set);
+	sigaddset(&usr1_set, SIGUSR1);
 
 	tidstack_init(&join_stack);
 
@@ -105,6 +140,11 @@ int main(int argc, char **argv){
 		sys_exit("Could not register SIGINT-handler", NULL);
 	if ((sigaction(SIGTERM, &sa, NULL)) < 0)
 		sys_exit("Could not register SIGTERM-handler", NULL);
+	// restart interrupted syscalls, a trace dump must not disturb the main loop
+	sa.sa_handler = &usr1handler;
+	sa.sa_flags = SA_RESTART;
+	if ((sigaction(SIGUSR1, &sa, NULL)) < 0)
+		sys_exit("Could not register SIGUSR1-handler", NULL);
 
 	// semaphore to prevent arguments for threads getting out of scope before thread made a local copy
     if ((copysem_id=semget(IPC_PRIVATE, 1, 0660)) < 0)
@@ -134,6 +174,9 @@ int main(int argc, char **argv){
 	int reuse = 1;
 	setsockopt(server_sockfd, SOL_SOCKET, SO_REUSEADDR, (const char *) &reuse, sizeof(reuse));
 
+	// buffer sizes have to be set before listen() to take effect on the tcp window
+	lowlat_apply_server(&lowlat_profile, server_sockfd);
+
 	if (bind(server_sockfd, (struct sockaddr *) &server_addr, addrlen) == -1)
 		sys_exit("Server Fault : BIND", &server_sockfd);
 
@@ -143,12 +186,24 @@ int main(int argc, char **argv){
 	printf("Waiting for incoming connections...\n");
 	while (!exit_requested) {
 
+		if (trace_dump_requested) {
+			trace_dump_requested = 0;
+			trace_ring_print();
+		}
+
 		// wait with accepting connections if too many active
 		if (thread_counter >= MAX_THREADS){
 			usleep(100);
 			continue;
 		}
 		
+		// low-latency profile: sleep in poll() until a connection arrives instead of polling accept()
+		if (lowlat_profile.enabled) {
+			struct pollfd pfd = {server_sockfd, POLLIN, 0};
+			if (poll(&pfd, 1, LOWLAT_WAIT_MSEC) <= 0)
+				continue; // timeout or signal -> check flags
+		}
+
 		// wait for incoming TCP connection (connect() call from somewhere else)
 		if ((client_sockfd = accept(server_sockfd, (struct sockaddr *) &client_addr, &addrlen)) < 0){
 			if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -161,6 +216,8 @@ int main(int argc, char **argv){
 				break;
 			}
 		}
+		TRACE_PROBE1(accept, client_id_counter);
+		const uint64_t accept_ts = trace_stamp();
 
 		/* 	prepare args and create separate thread to handle connection
 		 	lock semaphore to make sure the thread can create a local copy of his args and can safely push his tid on tidstack
@@ -170,8 +227,11 @@ int main(int argc, char **argv){
 			break;
 		} 
 
-		const thread_args_t th_args = {client_sockfd, client_id_counter++, client_addr, addrlen};
+		const thread_args_t th_args = {client_sockfd, client_id_counter++, client_addr, addrlen, accept_ts};
+		// thread inherits the signal mask -> no SIGUSR1 cutting short blocking calls in connection threads
+		pthread_sigmask(SIG_BLOCK, &usr1_set, &old_set);
 		pthread_create(&tid, NULL, (const void *) &connection_thread, (void *) &th_args);
+		pthread_sigmask(SIG_SETMASK, &old_set, NULL);
 
 		// safely increment thread counter
 		if (pthread_mutex_lock(&threadcount_mutex) != 0) {
@@ -196,6 +256,7 @@ int main(int argc, char **argv){
 	}
 
 	tidstack_destroy(&join_stack);
+	trace_ring_destroy();
 	if (semctl(copysem_id, 0, IPC_RMID) < 0)
 		sys_warn("Could not delete Semaphore ");
 
@@ -223,7 +284,7 @@ void connection_thread(void * th_args) {
 	char* recvBUF = calloc(BUFSIZE, sizeof(char));
 	char* sendBUF = calloc(BUFSIZE, sizeof(char));
 	char* filepathBUF = calloc(FILEPATH_BUF, sizeof(char));
-	int msglen = 0, fileLEN = 0, fd;
+	int msglen = 0, recvlen = 0, fileLEN = 0, fd; // recvlen: bytes of current request in recvBUF
 	off_t offset = 0;
 
 	char* lineBUF, *saveptr1, *saveptr2; // saveptrs needed for strtok_r;
@@ -232,20 +293,42 @@ void connection_thread(void * th_args) {
 	char* pathptr; // path in request
 	int request_flags = 0; // flags set during check_http_request()
 
+	char* bodyptr; // start of request body bytes received together with the headers
+	size_t body_len;
+	long long content_length;
+	int chunked, expect_continue, status;
+	upload_file_t upload_file; // temp file of a running upload
+	ssize_t sent; // by sendfile
+
+	// phase timestamps of the current request, accept was stamped in main
+	trace_record_t trace = {0};
+	trace.client_nr = args.clientnr;
+	trace.ts[TRACE_ACCEPT] = args.accept_ts;
+	TRACE_PROBE1(handoff, args.clientnr);
+	trace_mark(&trace, TRACE_HANDOFF);
+
 	// setup exit-handler
 	thread_exit_args_t exit_args = {args.connfd, recvBUF, sendBUF, filepathBUF};
 	pthread_cleanup_push((void *) &thread_exithandler, (void *) &exit_args);
 
 	printf("Connection accepted from: %s (client %d)\n", inet_ntoa(args.client_addr.sin_addr), args.clientnr);
+
+	// no-op if low-latency profile is disabled
+	lowlat_apply_client(&lowlat_profile, args.connfd);
+	lowlat_pin_thread(&lowlat_profile, args.connfd, args.clientnr);
+
 	while (!exit_requested) {
 		
 		// use MSG_DONTWAIT to prevent blocking on this call (sets EAGAIN or EWOULDBLOCK if no data)
-		msglen = recvfrom(args.connfd, recvBUF, BUFSIZE-1, MSG_DONTWAIT, (struct sockaddr *) &args.client_addr, &args.addrlen);
+		// low-latency profile blocks instead (busy polls), SO_RCVTIMEO sets EAGAIN after LOWLAT_WAIT_MSEC
+		msglen = recvfrom(args.connfd, recvBUF+recvlen, BUFSIZE-1-recvlen, lowlat_profile.enabled ? 0 : MSG_DONTWAIT,
+						  (struct sockaddr *) &args.client_addr, &args.addrlen);
 		if (msglen < 0){
-			if (errno == EAGAIN || errno == EWOULDBLOCK){
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR){
 				// in case of non-blocking socket and no data arrived -> sleep and loop again
 				// this is needed so that the thread checks exit_requested without blocking on recvfrom
-				usleep(200);
+				if (!lowlat_profile.enabled)
+					usleep(200);
 				continue;
 			} else if (errno == ECONNRESET) {
 				printf("client %d (%s): reset connection\n", args.clientnr, inet_ntoa(args.client_addr.sin_addr));
@@ -257,15 +340,41 @@ void connection_thread(void * th_args) {
 			}
 		}
 
-		if (msglen == 0){ // in case of implementing keep alive http option, dont break here and continue
+		if (msglen == 0 && recvlen == 0){ // in case of implementing keep alive http option, dont break here and continue
 			printf("client %d (%s): closed connection\n", args.clientnr, inet_ntoa(args.client_addr.sin_addr));
 			break;
 		}
 
+		recvlen += msglen;
+		recvBUF[recvlen] = '\0';
+
+		// headers end with an empty line, keep receiving until complete, buffer full or client done sending
+		if (msglen > 0 && recvlen < BUFSIZE-1 && strstr(recvBUF, "\r\n\r\n") == NULL)
+			continue;
+		msglen = recvlen;
+		recvlen = 0;
+
+		TRACE_PROBE2(recv, args.clientnr, msglen);
+		trace_mark(&trace, TRACE_RECV);
+
+		// split off body bytes that arrived together with the headers (only used by uploads)
+		// headers end with an empty line, terminate string after the last header line
+		bodyptr = strstr(recvBUF, "\r\n\r\n");
+		body_len = 0;
+		if (bodyptr != NULL) {
+			bodyptr[2] = '\0';
+			bodyptr += 4;
+			body_len = (size_t)msglen - (size_t)(bodyptr-recvBUF);
+		}
+
 		// parse first line of request
 		// strtok_r because we parse whole lines and tokenize again inside each line -> operating on same buffer
 		lineBUF = strtok_r(recvBUF, delimeter, &saveptr1);
+		pathptr = NULL;
 		request_flags = check_http_request(lineBUF, &pathptr, MAX_REQUEST_PATHLEN, &saveptr2);
+		TRACE_PROBE3(parse, args.clientnr, request_flags, pathptr);
+		trace_mark(&trace, TRACE_PARSE);
+		trace_set_request(&trace, request_flags, pathptr);
 
 		// print sth like: "client 1: GET /requested-path"
 		print_client_msgtype(request_flags, pathptr, args.clientnr, inet_ntoa(args.client_addr.sin_addr));
@@ -273,34 +382,110 @@ void connection_thread(void * th_args) {
 		// if no valid http request drop packet buffer, send "400-Bad request" and continue;
 		if (request_flags < 1 || request_flags & INVALID_REQUEST) {
 			send_400(args.connfd, sendBUF, sizeof(sendBUF));
+			trace_request_done(&trace);
 			continue;
 		}
 
-		// POST-request not supported, send "501, not implemented"
-		if (request_flags & HTTP_POST) {
-			send_501(args.connfd, sendBUF, sizeof(sendBUF));
-			continue;
+		// POST/PUT only supported below UPLOAD_PATH, else send "501, not implemented"
+		if (request_flags & (HTTP_POST | HTTP_PUT)) {
+			if ((request_flags & EMPTY_PATH) || strncmp(pathptr, UPLOAD_PATH, strlen(UPLOAD_PATH)) != 0) {
+				send_501(args.connfd, sendBUF, sizeof(sendBUF));
+				trace_request_done(&trace);
+				continue;
+			}
+
+			// body could still be in the socket -> answer and close connection in any case
+			if (bodyptr == NULL && msglen >= BUFSIZE-1) {
+				send_431(args.connfd, sendBUF, BUFSIZE);
+				trace_request_done(&trace);
+				break;
+			}
+			chunked = check_http_body_headers(&saveptr1, delimeter, &content_length, &expect_continue);
+			if (bodyptr == NULL || chunked < 0 || pathptr[strlen(pathptr)-1] == '/') {
+				send_400(args.connfd, sendBUF, BUFSIZE);
+				trace_request_done(&trace);
+				break;
+			}
+			if (check_path_traversal(pathptr)) {
+				send_403(args.connfd, sendBUF, BUFSIZE);
+				trace_request_done(&trace);
+				break;
+			}
+			if (!chunked && content_length < 0) {
+				send_411(args.connfd, sendBUF, BUFSIZE); // no way to tell where the body ends
+				trace_request_done(&trace);
+				break;
+			}
+			if (!chunked && content_length > UPLOAD_MAX_SIZE) {
+				send_413(args.connfd, sendBUF, BUFSIZE);
+				trace_request_done(&trace);
+				break;
+			}
+
+			// buffer might still hold the path of an earlier request on this connection (i.e after 404)
+			snprintf(filepathBUF, FILEPATH_BUF, "%s%s", FILE_ROOT, pathptr);
+			status = upload_open(&upload_file, filepathBUF);
+			if (status == 0) {
+				// HTTP/1.1 clients hold back the body until told to go on
+				if (expect_continue)
+					send_100(args.connfd);
+				status = upload_receive(&upload_file, args.connfd, filepathBUF, bodyptr, body_len,
+										content_length, chunked, &exit_requested);
+			}
+			TRACE_PROBE3(transfer, args.clientnr, status, (status == CREATED && !chunked) ? content_length : -1LL);
+			trace_mark(&trace, TRACE_TRANSFER);
+			if (status == CREATED) {
+				printf("client %d (%s): stored %s\n", args.clientnr, inet_ntoa(args.client_addr.sin_addr), pathptr);
+				send_201(args.connfd, sendBUF, BUFSIZE);
+			}
+			else if (status == NOT_FOUND) send_404(args.connfd, sendBUF, BUFSIZE);
+			else if (status == LENGTH_REQUIRED) send_411(args.connfd, sendBUF, BUFSIZE);
+			else if (status == PAYLOAD_TOO_LARGE) send_413(args.connfd, sendBUF, BUFSIZE);
+			else if (status == INTERNAL_SERVER_ERROR) send_500(args.connfd, sendBUF, BUFSIZE);
+			else if (status == BAD_REQUEST) send_400(args.connfd, sendBUF, BUFSIZE);
+			trace_request_done(&trace);
+			break;
 		}
 
+		// dump trace ring on admin path (only if enabled, else served like any other path)
+		// other clients' paths and timings are only shown to local clients
+		if ((request_flags & HTTP_GET) && trace_ring_enabled && strcmp(pathptr, TRACE_ADMIN_PATH) == 0) {
+			if ((ntohl(args.client_addr.sin_addr.s_addr) >> 24) == 127)
+				send_trace_dump(args.connfd, sendBUF);
+			else
+				send_403(args.connfd, sendBUF, BUFSIZE);
+		}
 		// react on GET
-		if ((request_flags & HTTP_GET) && !(request_flags & EMPTY_PATH)) {
-			// add /var/microwww/ to the path
-			strcat(filepathBUF, FILE_ROOT);
-			strcat(filepathBUF, pathptr);
+		else if ((request_flags & HTTP_GET) && !(request_flags & EMPTY_PATH)) {
+			// add /var/microwww/ to the path (overwrite, earlier 404 paths don't reset the buffer)
+			snprintf(filepathBUF, FILEPATH_BUF, "%s%s", FILE_ROOT, pathptr);
+			// don't serve files outside of FILE_ROOT
+			if (check_path_traversal(pathptr)) {
+				send_403(args.connfd, sendBUF, BUFSIZE);
+				trace_request_done(&trace);
+				continue;
+			}
 			// check if file exists/ can be read, if not send 404 
 			fd = open(filepathBUF, O_RDONLY);
 			if (fd < 0) {
+				TRACE_PROBE3(open, args.clientnr, errno, -1LL);
+				trace_mark(&trace, TRACE_OPEN);
 				send_404(args.connfd, sendBUF, sizeof(sendBUF));
+				trace_request_done(&trace);
 				continue;
 			}
 			else {
 				// gathering filesize
 				fileLEN = file_size(filepathBUF);
+				TRACE_PROBE3(open, args.clientnr, 0, (long long)fileLEN);
+				trace_mark(&trace, TRACE_OPEN);
 				// sending OK 
 				send_200(args.connfd, fileLEN, sendBUF, sizeof(sendBUF));
 				// note: sendfile is not in a posix standart and only works on linux. programm is not portable 
-				 if ((sendfile(args.connfd, fd , &offset, fileLEN)) < 0) 
+				 if ((sent = sendfile(args.connfd, fd , &offset, fileLEN)) < 0) 
 				 	sys_warn("Server Fault: SENDFILE");
+				TRACE_PROBE3(transfer, args.clientnr, (int)OK, (long long)sent);
+				trace_mark(&trace, TRACE_TRANSFER);
 				
 				// close opened file
 				if ((close(fd)) < 0) 
@@ -320,6 +505,7 @@ void connection_thread(void * th_args) {
 		memset(recvBUF, 0, BUFSIZE); 
 		memset(sendBUF, 0, BUFSIZE);
 		memset(filepathBUF, 0, FILEPATH_BUF);
+		trace_request_done(&trace);
 	}
 
 	// remove exit_handler (and run it)
@@ -357,8 +543,30 @@ int sem_operation(int op) {
     sbuf.sem_op = op;
     sbuf.sem_flg = SEM_UNDO;
 
-    if (semop(copysem_id, &sbuf, 1) < 0)
-        return -1;
+    // semop is never restarted after a signal handler (i.e SIGUSR1) -> retry
+    while (semop(copysem_id, &sbuf, 1) < 0)
+        if (errno != EINTR)
+            return -1;
 
     return 0;
 }
+
+// send trace ring as 200 response (dump buffer on heap, can be way bigger than sendBUF)
+static void send_trace_dump(const int connfd, char* sendBUF) {
+	const size_t buflen = (TRACE_RING_SIZE+1)*TRACE_LINE_MAX;
+	char* dumpBUF = malloc(buflen);
+	if (!dumpBUF) {
+		sys_warn("send_trace_dump : malloc");
+		send_500(connfd, sendBUF, BUFSIZE);
+		return;
+	}
+
+	// send_200 would label the dump as text/html
+	const size_t dumplen = trace_ring_dump(dumpBUF, buflen);
+	snprintf(sendBUF, BUFSIZE, "HTTP/1.0 200 OK\r\nContent-type: text/plain\r\nContent-length: %zu\r\n"
+			 "Server: MicroWWW Team 06\r\n\r\n", dumplen);
+	if (send(connfd, sendBUF, strlen(sendBUF), 0) < 0 || send(connfd, dumpBUF, dumplen, 0) < 0)
+		sys_warn("send_trace_dump : send");
+
+	free(dumpBUF);
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "trace.h"
+#include "http_funcs.h"
+
+int trace_ring_enabled = 0;
+
+static trace_record_t* ring = NULL;
+static size_t ring_size = 0;
+static size_t ring_next = 0; // total nr of records pushed, ring_next % ring_size is the next slot
+// pushed once per request by every connection thread, read on dump
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* phase_names[TRACE_NR_PHASES] = {
+    "accept", "handoff", "recv", "parse", "open", "transfer", "done"
+};
+
+// alloc ring and enable timestamps
+void trace_ring_init(size_t nr_records) {
+    if (trace_ring_enabled) return; // i.e -t given twice
+
+    ring = (trace_record_t*)calloc(nr_records, sizeof(trace_record_t));
+    if (!ring) {
+        perror("trace_ring_init() : calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    ring_size = nr_records;
+    ring_next = 0;
+    trace_ring_enabled = 1;
+}
+
+void trace_ring_destroy(void) {
+    trace_ring_enabled = 0;
+    free(ring);
+    ring = NULL;
+    ring_size = 0;
+}
+
+// set request info shown in the dump (path might be NULL)
+void trace_set_request(trace_record_t* rec, const int request_flags, const char* path) {
+    if (!trace_ring_enabled) return;
+
+    rec->request_flags = request_flags;
+    if (path) {
+        strncpy(rec->path, path, TRACE_PATH_LEN-1);
+        rec->path[TRACE_PATH_LEN-1] = '\0';
+    }
+}
+
+// stamp TRACE_DONE, copy record into the ring and reset it for the next request on the connection
+void trace_request_done(trace_record_t* rec) {
+    TRACE_PROBE1(done, rec->client_nr);
+    if (!trace_ring_enabled) return;
+
+    rec->ts[TRACE_DONE] = trace_now();
+
+    if (pthread_mutex_lock(&ring_mutex) == 0) {
+        ring[ring_next++ % ring_size] = *rec;
+        pthread_mutex_unlock(&ring_mutex);
+    }
+
+    const int client_nr = rec->client_nr;
+    memset(rec, 0, sizeof(trace_record_t));
+    rec->client_nr = client_nr;
+}
+
+// method name for dump
+static const char* method_str(const int request_flags) {
+    if (request_flags < 0 || request_flags & INVALID_REQUEST) return "BAD";
+    if (request_flags & HTTP_GET) return "GET";
+    if (request_flags & HTTP_POST) return "POST";
+    if (request_flags & HTTP_PUT) return "PUT";
+    if (request_flags & HTTP_HEAD) return "HEAD";
+    return "-";
+}
+
+// format one record, times in us relative to the previous phase reached
+static int format_record(const trace_record_t* rec, char* buf, const size_t buflen) {
+    int len = snprintf(buf, buflen, "client %d %s %s:", rec->client_nr, method_str(rec->request_flags),
+                       rec->path[0] ? rec->path : "-");
+    uint64_t first = 0, prev = 0;
+
+    for (int i=0; i<TRACE_NR_PHASES && len < (int)buflen; i++) {
+        if (rec->ts[i] == 0) continue;
+        if (first == 0) first = prev = rec->ts[i];
+        len += snprintf(buf+len, buflen-len, " %s +%.3f", phase_names[i], (rec->ts[i]-prev)/1000.0);
+        prev = rec->ts[i];
+    }
+    if (len < (int)buflen)
+        len += snprintf(buf+len, buflen-len, " total %.3f\n", (prev-first)/1000.0);
+
+    return len < (int)buflen ? len : (int)buflen-1;
+}
+
+/*  Writes the records in the ring (oldest first) as text into buf (always null-terminated).
+    returns number of bytes written   */
+size_t trace_ring_dump(char* buf, const size_t buflen) {
+    if (buf == NULL || buflen == 0) return 0;
+
+    size_t len = 0;
+    buf[0] = '\0';
+
+    if (!trace_ring_enabled) {
+        len = snprintf(buf, buflen, "# trace ring disabled (start with -t)\n");
+        return len < buflen ? len : buflen-1;
+    }
+
+    if (pthread_mutex_lock(&ring_mutex) != 0) return 0;
+
+    const size_t nr_records = ring_next < ring_size ? ring_next : ring_size;
+    len = snprintf(buf, buflen, "# last %zu of %zu requests, us since previous phase\n", nr_records, ring_next);
+    if (len >= buflen) len = buflen-1;
+
+    for (size_t i=ring_next-nr_records; i<ring_next && len < buflen-1; i++)
+        len += format_record(&ring[i % ring_size], buf+len, buflen-len);
+
+    pthread_mutex_unlock(&ring_mutex);
+    return len;
+}
+
+// dump ring to stdout (called from main thread on SIGUSR1)
+void trace_ring_print(void) {
+    const size_t buflen = (ring_size+1)*TRACE_LINE_MAX;
+    char* buf = malloc(buflen);
+    if (!buf) {
+        perror("trace_ring_print() : malloc");
+        return;
+    }
+
+    trace_ring_dump(buf, buflen);
+    fputs(buf, stdout);
+    fflush(stdout);
+    free(buf);
+}
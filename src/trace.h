@@ -0,0 +1,98 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+// per-request phase tracing: USDT probes (provider "microwww") at each phase boundary and an
+// optional ring of recent request traces (enabled with -t, dumped on SIGUSR1 or via TRACE_ADMIN_PATH)
+
+#define TRACE_RING_SIZE 256 // nr of requests kept
+#define TRACE_PATH_LEN 64 // longer paths get truncated in the ring
+#define TRACE_LINE_MAX 256 // max length of one dumped record
+#define TRACE_ADMIN_PATH "/.trace" // GET dumps the ring if enabled
+
+// static probes are nops unless a tracer attaches (needs sys/sdt.h from systemtap-sdt-dev)
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE_HAVE_SDT
+#endif
+#endif
+
+#ifdef TRACE_HAVE_SDT
+#define TRACE_PROBE1(name, a) DTRACE_PROBE1(microwww, name, a)
+#define TRACE_PROBE2(name, a, b) DTRACE_PROBE2(microwww, name, a, b)
+#define TRACE_PROBE3(name, a, b, c) DTRACE_PROBE3(microwww, name, a, b, c)
+#else
+#define TRACE_PROBE1(name, a) do { (void)(a); } while (0)
+#define TRACE_PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#define TRACE_PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while (0)
+#endif
+
+/*  Probes (args in this order), i.e. bpftrace -e 'usdt:./server:microwww:recv { @[arg1] = count(); }'
+    accept(int client_nr)                                   accept() returned in main thread
+    handoff(int client_nr)                                  connection thread started
+    recv(int client_nr, int len)                            request headers received (len bytes incl. body part)
+    parse(int client_nr, int request_flags, char* path)     request line parsed, flags see enum request_flags,
+                                                            flags < 0 on parse error, path might be NULL
+    open(int client_nr, int err, long long size)            requested file opened, err is 0 or errno of open(),
+                                                            size is -1 on error
+    transfer(int client_nr, int status, long long bytes)    sendfile() done or upload stored, status is the http
+                                                            status code answered, bytes is -1 if unknown/failed
+    done(int client_nr)                                     request finished   */
+
+enum trace_phases {
+    TRACE_ACCEPT,   // accept() returned in main thread
+    TRACE_HANDOFF,  // connection thread running with its own copy of the args
+    TRACE_RECV,     // recvfrom() returned the request
+    TRACE_PARSE,    // request line (and headers) parsed
+    TRACE_OPEN,     // requested file opened and size gathered
+    TRACE_TRANSFER, // sendfile() finished or upload body stored
+    TRACE_DONE,     // response sent, request finished
+    TRACE_NR_PHASES
+};
+
+typedef struct {
+    int client_nr;
+    int request_flags;
+    char path[TRACE_PATH_LEN];
+    uint64_t ts[TRACE_NR_PHASES]; // CLOCK_MONOTONIC in ns, 0 if phase not reached
+} trace_record_t;
+
+// only written by trace_ring_init() before threads get created
+extern int trace_ring_enabled;
+
+static inline uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// timestamp for the ring, 0 (and no clock read) if ring disabled
+static inline uint64_t trace_stamp(void) {
+    return trace_ring_enabled ? trace_now() : 0;
+}
+
+static inline void trace_mark(trace_record_t* rec, const enum trace_phases phase) {
+    if (trace_ring_enabled) rec->ts[phase] = trace_now();
+}
+
+void trace_ring_init(size_t nr_records);
+void trace_ring_destroy(void);
+
+// set request info shown in the dump (path might be NULL)
+void trace_set_request(trace_record_t* rec, const int request_flags, const char* path);
+
+// stamp TRACE_DONE, copy record into the ring and reset it for the next request on the connection
+void trace_request_done(trace_record_t* rec);
+
+/*  Writes the records in the ring (oldest first) as text into buf (always null-terminated).
+    returns number of bytes written   */
+size_t trace_ring_dump(char* buf, const size_t buflen);
+
+// dump ring to stdout (called from main thread on SIGUSR1)
+void trace_ring_print(void);
+
+#endif // TRACE_H
@@ -0,0 +1,270 @@
+#define _GNU_SOURCE // splice, pipe2, F_SETPIPE_SZ
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include "upload.h"
+#include "http_funcs.h"
+#include "helper_funcs.h"
+
+typedef struct {
+    int connfd;
+    int filefd;
+    int pipefd[2];
+    size_t pipe_size;
+    const char* pending; // body bytes received together with the headers, consumed first
+    size_t pending_len;
+    long long total; // bytes written to file so far
+    const volatile sig_atomic_t* exit_flag;
+} upload_ctx_t;
+
+// wait until connfd has data, return 0 if readable else status code to answer with (-1 on exit)
+static int wait_readable(upload_ctx_t* ctx) {
+    struct pollfd pfd = {ctx->connfd, POLLIN, 0};
+    int waited = 0, ret;
+
+    while (!*ctx->exit_flag) {
+        ret = poll(&pfd, 1, UPLOAD_POLL_MS);
+        if (ret > 0) return 0; // also on POLLHUP/POLLERR, the following read reports it
+        if (ret < 0 && errno != EINTR) {
+            sys_warn("upload : poll");
+            return INTERNAL_SERVER_ERROR;
+        }
+        if (ret == 0 && (waited += UPLOAD_POLL_MS) >= UPLOAD_TIMEOUT_MS)
+            return BAD_REQUEST;
+    }
+    return -1;
+}
+
+// write buffered body bytes to file, return 0 on success or -1 if failure
+static int write_all(const int fd, const char* buf, size_t len) {
+    ssize_t written;
+    while (len > 0) {
+        if ((written = write(fd, buf, len)) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += written;
+        len -= (size_t)written;
+    }
+    return 0;
+}
+
+/*  Moves len body bytes to the file: pending bytes with write(), the rest socket -> pipe -> file
+    with splice() so the data never gets copied through userspace.
+    returns 0 on success else status code to answer with (-1 on exit)   */
+static int copy_body(upload_ctx_t* ctx, long long len) {
+
+    // compare against the remaining budget, total + len could overflow for huge chunk sizes
+    if (len > UPLOAD_MAX_SIZE - ctx->total) return PAYLOAD_TOO_LARGE;
+    ctx->total += len;
+
+    size_t n = ctx->pending_len < (size_t)len ? ctx->pending_len : (size_t)len;
+    if (n > 0) {
+        if (write_all(ctx->filefd, ctx->pending, n) < 0) {
+            sys_warn("upload : write");
+            return INTERNAL_SERVER_ERROR;
+        }
+        ctx->pending += n;
+        ctx->pending_len -= n;
+        len -= (long long)n;
+    }
+
+    ssize_t in, out;
+    int ret;
+    while (len > 0) {
+        if ((ret = wait_readable(ctx)) != 0) return ret;
+
+        n = (size_t)len < ctx->pipe_size ? (size_t)len : ctx->pipe_size;
+        in = splice(ctx->connfd, NULL, ctx->pipefd[1], NULL, n, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (in < 0) {
+            if (errno == EAGAIN || errno == EINTR) continue;
+            sys_warn("upload : splice from socket");
+            return BAD_REQUEST;
+        }
+        if (in == 0) return BAD_REQUEST; // client closed before sending the whole body
+        len -= in;
+
+        // drain pipe completely so the next splice from the socket only waits for the socket
+        while (in > 0) {
+            if ((out = splice(ctx->pipefd[0], NULL, ctx->filefd, NULL, (size_t)in, SPLICE_F_MOVE)) < 0) {
+                if (errno == EINTR) continue;
+                sys_warn("upload : splice to file");
+                return INTERNAL_SERVER_ERROR;
+            }
+            in -= out;
+        }
+    }
+    return 0;
+}
+
+/*  Reads one CRLF terminated line (chunk size or trailer) into lineBUF without the CRLF.
+    Peeks on the socket to never consume bytes following the line.
+    returns 0 on success else status code to answer with (-1 on exit)   */
+static int read_line(upload_ctx_t* ctx, char* lineBUF, const size_t buflen) {
+    size_t len = 0;
+    ssize_t peeked;
+    char* lf;
+    int ret;
+
+    while (1) {
+        if (len >= buflen-1) return BAD_REQUEST;
+
+        if (ctx->pending_len > 0) {
+            ctx->pending_len--;
+            if ((lineBUF[len++] = *ctx->pending++) == '\n') break;
+            continue;
+        }
+
+        if ((ret = wait_readable(ctx)) != 0) return ret;
+        peeked = recv(ctx->connfd, lineBUF+len, buflen-1-len, MSG_PEEK | MSG_DONTWAIT);
+        if (peeked < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            return BAD_REQUEST;
+        }
+        if (peeked == 0) return BAD_REQUEST;
+
+        // consume up to and including the line feed (data is already queued, won't block)
+        lf = memchr(lineBUF+len, '\n', (size_t)peeked);
+        if (lf) peeked = lf-(lineBUF+len)+1;
+        if (recv(ctx->connfd, lineBUF+len, (size_t)peeked, MSG_DONTWAIT) != peeked)
+            return BAD_REQUEST;
+        len += (size_t)peeked;
+        if (lf) break;
+    }
+
+    if (len < 2 || lineBUF[len-2] != '\r') return BAD_REQUEST;
+    lineBUF[len-2] = '\0';
+    return 0;
+}
+
+// receive chunked body (see RFC 7230 4.1), return 0 on success else status code (-1 on exit)
+static int copy_chunked_body(upload_ctx_t* ctx) {
+    char lineBUF[UPLOAD_CHUNKLINE_MAX];
+    char* end;
+    long long chunk_size;
+    int ret;
+
+    while (1) {
+        if ((ret = read_line(ctx, lineBUF, sizeof(lineBUF))) != 0) return ret;
+
+        // chunk-size is 1*HEXDIG, strtoll alone would also take whitespace, a sign or 0x
+        if (!isxdigit((unsigned char)lineBUF[0])) return BAD_REQUEST;
+        if (lineBUF[0] == '0' && (lineBUF[1] == 'x' || lineBUF[1] == 'X')) return BAD_REQUEST;
+
+        errno = 0;
+        chunk_size = strtoll(lineBUF, &end, 16);
+        if (end == lineBUF || errno != 0 || chunk_size < 0) return BAD_REQUEST;
+        if (*end != '\0' && *end != ';' && *end != ' ' && *end != '\t') return BAD_REQUEST;
+        if (chunk_size == 0) break; // last chunk
+
+        if ((ret = copy_body(ctx, chunk_size)) != 0) return ret;
+
+        // chunk data is followed by CRLF
+        if ((ret = read_line(ctx, lineBUF, sizeof(lineBUF))) != 0) return ret;
+        if (lineBUF[0] != '\0') return BAD_REQUEST;
+    }
+
+    // skip trailer fields until the empty line
+    do {
+        if ((ret = read_line(ctx, lineBUF, sizeof(lineBUF))) != 0) return ret;
+    } while (lineBUF[0] != '\0');
+
+    return 0;
+}
+
+/*  Creates the temp file next to filepath (same filesystem for rename()).
+    Called before answering "100 Continue" so a missing target directory is reported before the body is sent.
+    returns 0 on success else status code to answer with   */
+int upload_open(upload_file_t* file, const char* filepath) {
+
+    file->filefd = -1;
+    const char* slash = strrchr(filepath, '/');
+    int dirlen = slash ? (int)(slash-filepath) : 1;
+    if (snprintf(file->tmppath, sizeof(file->tmppath), "%.*s/.upload-XXXXXX", dirlen, slash ? filepath : ".")
+        >= (int)sizeof(file->tmppath))
+        return BAD_REQUEST;
+
+    if ((file->filefd = mkstemp(file->tmppath)) < 0) {
+        if (errno == ENOENT || errno == ENOTDIR) return NOT_FOUND;
+        sys_warn("upload : mkstemp");
+        return INTERNAL_SERVER_ERROR;
+    }
+    // mkstemp creates with 0600, uploaded files should be servable like the others
+    if (fchmod(file->filefd, 0644) < 0)
+        sys_warn("upload : fchmod");
+
+    return 0;
+}
+
+/*  Receives a request body from connfd into file (see upload_open) and renames it to filepath.
+    body/body_len are the body bytes already received together with the headers.
+    content_length is ignored if chunked is set.
+    Stops early if *exit_flag gets set. Always closes file, temp file gets removed on failure.
+    returns http status code to answer with (CREATED on success) or -1 if aborted by exit_flag   */
+int upload_receive(upload_file_t* file, const int connfd, const char* filepath, const char* body, size_t body_len,
+                   const long long content_length, const int chunked, const volatile sig_atomic_t* exit_flag) {
+
+    upload_ctx_t ctx = {connfd, file->filefd, {-1, -1}, 0, body, body_len, 0, exit_flag};
+    int status = INTERNAL_SERVER_ERROR, ret;
+
+    if (!chunked && content_length < 0) {
+        status = LENGTH_REQUIRED; // no way to tell where the body ends
+        goto cleanup;
+    }
+    if (!chunked && content_length > UPLOAD_MAX_SIZE) {
+        status = PAYLOAD_TOO_LARGE;
+        goto cleanup;
+    }
+
+    if (pipe2(ctx.pipefd, O_CLOEXEC) < 0) {
+        sys_warn("upload : pipe2");
+        goto cleanup;
+    }
+    // bigger pipe -> fewer splice calls per upload, keep default size if not permitted
+    if ((ret = fcntl(ctx.pipefd[1], F_SETPIPE_SZ, UPLOAD_PIPE_SIZE)) < 0)
+        ret = fcntl(ctx.pipefd[1], F_GETPIPE_SZ);
+    ctx.pipe_size = ret > 0 ? (size_t)ret : 4096;
+
+    if (chunked)
+        ret = copy_chunked_body(&ctx);
+    else
+        ret = copy_body(&ctx, content_length);
+    if (ret != 0) {
+        status = ret;
+        goto cleanup;
+    }
+
+    // data has to be on disk before the rename makes it visible
+    if (fsync(ctx.filefd) < 0) {
+        sys_warn("upload : fsync");
+        goto cleanup;
+    }
+    if (close(ctx.filefd) < 0) {
+        ctx.filefd = -1;
+        sys_warn("upload : close");
+        goto cleanup;
+    }
+    ctx.filefd = -1;
+
+    if (rename(file->tmppath, filepath) < 0) {
+        sys_warn("upload : rename");
+        goto cleanup;
+    }
+    status = CREATED;
+
+cleanup:
+    if (ctx.pipefd[0] >= 0) close(ctx.pipefd[0]);
+    if (ctx.pipefd[1] >= 0) close(ctx.pipefd[1]);
+    if (ctx.filefd >= 0) close(ctx.filefd);
+    file->filefd = -1;
+    if (status != CREATED) unlink(file->tmppath);
+    return status;
+}
@@ -0,0 +1,36 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <stdlib.h>
+#include <signal.h>
+#include <limits.h>
+
+// streaming POST/PUT request bodies to disk: socket -> pipe -> file with splice(),
+// written to a temp file in the target directory and renamed into place when complete
+
+#define UPLOAD_PATH "/upload/" // only requests below this path may upload
+#define UPLOAD_MAX_SIZE (1024LL*1024*1024) // max body size in bytes
+#define UPLOAD_PIPE_SIZE (1024*1024) // try to grow pipe to this size (see F_SETPIPE_SZ)
+#define UPLOAD_POLL_MS 200 // check exit flag at least this often while waiting for data
+#define UPLOAD_TIMEOUT_MS 10000 // give up if client sends nothing for this long
+#define UPLOAD_CHUNKLINE_MAX 64 // max length of a chunk size line incl. extensions
+
+typedef struct {
+    int filefd;
+    char tmppath[PATH_MAX]; // temp file, renamed to the target when complete
+} upload_file_t;
+
+/*  Creates the temp file next to filepath (same filesystem for rename()).
+    Called before answering "100 Continue" so a missing target directory is reported before the body is sent.
+    returns 0 on success else status code to answer with   */
+int upload_open(upload_file_t* file, const char* filepath);
+
+/*  Receives a request body from connfd into file (see upload_open) and renames it to filepath.
+    body/body_len are the body bytes already received together with the headers.
+    content_length is ignored if chunked is set.
+    Stops early if *exit_flag gets set. Always closes file, temp file gets removed on failure.
+    returns http status code to answer with (CREATED on success) or -1 if aborted by exit_flag   */
+int upload_receive(upload_file_t* file, const int connfd, const char* filepath, const char* body, size_t body_len,
+                   const long long content_length, const int chunked, const volatile sig_atomic_t* exit_flag);
+
+#endif // UPLOAD_H